@@ -16,9 +16,14 @@ SmsWebhook &SmsWebhook::instance() {
 void SmsWebhook::setup() {
     os_mutex_create(&sendQueueMutex);
     stateHandler = &SmsWebhook::stateWaitForMessage;
+    addTrace(SmsTrace::Event::STATE, SmsTrace::STATE_WAIT_FOR_MESSAGE);
+
+    checkDelayedStorage();
 }
 
 void SmsWebhook::loop() {
+    unsigned long loopStart = trace ? micros() : 0;
+
     if (stateHandler) {
         stateHandler(*this);
     }
@@ -28,6 +33,11 @@ void SmsWebhook::loop() {
         (*it)->check();
     }
 
+    checkDelayedStorage();
+
+    if (trace) {
+        trace->addLoopTime(micros() - loopStart);
+    }
 }
 
 
@@ -38,7 +48,12 @@ void SmsWebhook::queueSms(SmsMessage smsMessage) {
 
     os_mutex_lock(sendQueueMutex);
     sendQueue.push_back(smsMessage);
+    size_t queueSize = sendQueue.size();
     os_mutex_unlock(sendQueueMutex);
+
+    if (trace) {
+        trace->add(SmsTrace::Event::QUEUE_PUSH, 0, (uint16_t)queueSize, strlen(smsMessage.getMessage()));
+    }
 }
 
 
@@ -52,6 +67,7 @@ SmsWebhook::~SmsWebhook() {
     if (sendQueueMutex) {
         os_mutex_destroy(sendQueueMutex);
     }
+    delete[] checkpointBuf;
 }
 
 
@@ -77,12 +93,21 @@ void SmsWebhook::stateWaitForMessage() {
     String recipient;
 
     if (!msg.hasRecipient()) {
-        if (recipientCallback && !recipientCallback(recipient)) {
+        bool hasRecipient = true;
+        if (recipientCallback) {
+            unsigned long callbackStart = trace ? micros() : 0;
+            hasRecipient = recipientCallback(recipient);
+            if (trace) {
+                trace->add(SmsTrace::Event::RECIPIENT, hasRecipient, 0, micros() - callbackStart);
+            }
+        }
+        if (!hasRecipient) {
             // Don't know the recipient yet; try again after timeout
             _log.info("no recipient");
             stateTime = millis();
             retryTimeMs = retryNoRecipientMs;
             stateHandler = &SmsWebhook::stateWaitRetry;
+            addTrace(SmsTrace::Event::STATE, SmsTrace::STATE_WAIT_RETRY);
             return;
         }
     }
@@ -105,30 +130,45 @@ void SmsWebhook::stateWaitForMessage() {
 
     // Have a message and are connected
     publishFuture = Particle.publish(eventName, jsonBuf, PRIVATE | WITH_ACK);
+    if (trace) {
+        trace->add(SmsTrace::Event::PUBLISH_START, 0, (uint16_t)strlen(jsonBuf));
+    }
 
     stateTime = millis();
     stateHandler = &SmsWebhook::stateWaitPublish;
+    addTrace(SmsTrace::Event::STATE, SmsTrace::STATE_WAIT_PUBLISH);
 }
 
 void SmsWebhook::stateWaitPublish() {
     // When checking the future, the isDone() indicates that the future has been resolved, 
     // basically this means that Particle.publish would have returned.
     if (publishFuture.isDone()) {
+        updatePacing(publishFuture.isSucceeded(), millis() - stateTime);
+        if (trace) {
+            trace->add(SmsTrace::Event::PUBLISH_RESULT, publishFuture.isSucceeded(), 0, millis() - stateTime);
+        }
+
         // isSucceeded() is whether the publish succeeded or not, which is basically the
         // boolean return value from Particle.publish.
         if (publishFuture.isSucceeded()) {
             _log.info("successfully published");
             os_mutex_lock(sendQueueMutex);
             sendQueue.pop_front();
+            size_t queueSize = sendQueue.size();
             os_mutex_unlock(sendQueueMutex);
+            addTrace(SmsTrace::Event::QUEUE_POP, 0, (uint16_t)queueSize);
             retryTimeMs = publishRateLimitMs;
         }
         else {
             _log.info("failed to publish, will try again");
             retryTimeMs = retryPublishFailMs;
         }
+        if (adaptivePacing) {
+            retryTimeMs = pacingIntervalMs;
+        }
         stateTime = millis();
         stateHandler = &SmsWebhook::stateWaitRetry;
+        addTrace(SmsTrace::Event::STATE, SmsTrace::STATE_WAIT_RETRY);
         return;
     }
 }
@@ -137,10 +177,60 @@ void SmsWebhook::stateWaitPublish() {
 void SmsWebhook::stateWaitRetry() {
     if (millis() - stateTime >= retryTimeMs) {
         stateHandler = &SmsWebhook::stateWaitForMessage;
+        addTrace(SmsTrace::Event::STATE, SmsTrace::STATE_WAIT_FOR_MESSAGE);
     }
 }
 
 
+SmsWebhook &SmsWebhook::withAdaptivePacing(unsigned long floorMs, unsigned long ceilingMs) {
+    adaptivePacing = true;
+    adaptiveFloorMs = floorMs;
+    adaptiveCeilingMs = std::max(floorMs, ceilingMs);
+    pacingIntervalMs = std::min(std::max(publishRateLimitMs, adaptiveFloorMs), adaptiveCeilingMs);
+    return *this;
+}
+
+void SmsWebhook::updatePacing(bool success, unsigned long ackMs) {
+    // Moving averages with a weight of 1/8 for the new sample. Failed publishes take the full
+    // ACK timeout, so only successful publishes are included in the ACK time.
+    if (success) {
+        if (avgAckMs == 0) {
+            avgAckMs = ackMs;
+        }
+        else {
+            avgAckMs = (avgAckMs * 7 + ackMs) / 8;
+        }
+    }
+    publishFailRate += ((success ? 0 : 100000) - publishFailRate) / 8;
+
+    if (!adaptivePacing) {
+        return;
+    }
+
+    // Rates are in publishes per minute, so interval = 60000 / rate
+    const uint64_t msPerMinute = 60000;
+    uint64_t interval = pacingIntervalMs;
+
+    if (!success) {
+        // Multiplicative decrease of the send rate, by 1x to 2x depending on the recent failure rate,
+        // but never retry sooner than the fixed publish fail retry time
+        interval = interval * (100000 + (uint64_t)publishFailRate) / 100000;
+        interval = std::max(interval, (uint64_t)retryPublishFailMs);
+    }
+    else if (avgAckMs > adaptiveSlowAckMs) {
+        // Link is slow, additive decrease of the send rate
+        uint64_t step = (uint64_t)adaptiveRateStep * interval;
+        interval = (step < msPerMinute) ? msPerMinute * interval / (msPerMinute - step) : adaptiveCeilingMs;
+    }
+    else {
+        // Additive increase of the send rate
+        interval = msPerMinute * interval / (msPerMinute + (uint64_t)adaptiveRateStep * interval);
+    }
+    pacingIntervalMs = (unsigned long)std::min(std::max(interval, (uint64_t)adaptiveFloorMs), (uint64_t)adaptiveCeilingMs);
+
+    _log.trace("pacing interval %lu ms (avg ack %lu ms, fail %u%%)", pacingIntervalMs, avgAckMs, getPublishFailPct());
+}
+
 void SmsWebhook::addDelayed(SmsMessageDelayed *obj) {
     delayedMessages.push_back(obj);
 }
@@ -156,6 +246,193 @@ void SmsWebhook::removeDelayed(SmsMessageDelayed *obj) {
     }
 }
 
+SmsWebhook &SmsWebhook::withDelayedStorage(SmsDelayedStorage *storage, unsigned long checkpointIntervalMs) {
+    // Allocated once here so saving from loop() does not use the heap
+    delete[] checkpointBuf;
+    checkpointBuf = storage ? new uint8_t[storage->getSize()] : 0;
+
+    this->delayedStorage = storage;
+    this->checkpointIntervalMs = checkpointIntervalMs;
+    restorePending = true;
+    return *this;
+}
+
+void SmsWebhook::checkDelayedStorage() {
+    if (!delayedStorage || !Time.isValid()) {
+        // Saved times are wall-clock times, so nothing can be done until the time is known
+        return;
+    }
+    if (!restorePending && !checkpointDirty) {
+        return;
+    }
+
+    // Saved data is a uint32_t magic, a uint32_t count, then count SmsDelayedRecord structs
+    const size_t headerSize = 2 * sizeof(uint32_t);
+    size_t size = delayedStorage->getSize();
+    if (size < headerSize) {
+        return;
+    }
+    size_t maxRecords = (size - headerSize) / sizeof(SmsDelayedRecord);
+
+    uint8_t *buf = checkpointBuf;
+    uint32_t *header = (uint32_t *)buf;
+    SmsDelayedRecord *records = (SmsDelayedRecord *)&buf[headerSize];
+    time_t now = Time.now();
+
+    if (restorePending) {
+        restorePending = false;
+
+        delayedStorage->load(buf);
+        if (header[0] == DELAYED_MAGIC && header[1] <= maxRecords) {
+            for(size_t ii = 0; ii < header[1]; ii++) {
+                for(auto it = delayedMessages.begin(); it != delayedMessages.end(); it++) {
+                    if ((*it)->getPersistId() != 0 && (*it)->getPersistId() == records[ii].persistId) {
+                        (*it)->restoreState(records[ii], now);
+                    }
+                }
+            }
+            _log.info("restored %u delayed messages", (unsigned int)header[1]);
+        }
+        // Otherwise the saved data is not valid (first use, or retained memory after power loss).
+        // It's replaced by the first save, which is not delayed by the checkpoint interval.
+    }
+    else if (!hasCheckpointed || millis() - lastCheckpoint >= checkpointIntervalMs) {
+        // The first save after boot happens right away, so a device that resets more often than
+        // the checkpoint interval still saves. Later changes are batched within the interval.
+        memset(buf, 0, size);
+        header[0] = DELAYED_MAGIC;
+        header[1] = 0;
+        for(auto it = delayedMessages.begin(); it != delayedMessages.end() && header[1] < maxRecords; it++) {
+            if ((*it)->getPersistId() != 0 && (*it)->saveState(records[header[1]], now)) {
+                header[1]++;
+            }
+        }
+        delayedStorage->save(buf);
+
+        lastCheckpoint = millis();
+        hasCheckpointed = true;
+        checkpointDirty = false;
+    }
+}
+
+void SmsDelayedStorageEEPROM::load(uint8_t *buf) {
+    for(size_t ii = 0; ii < size; ii++) {
+        buf[ii] = EEPROM.read(offset + ii);
+    }
+}
+
+void SmsDelayedStorageEEPROM::save(const uint8_t *buf) {
+    for(size_t ii = 0; ii < size; ii++) {
+        // Only write bytes that changed to reduce flash wear
+        if (EEPROM.read(offset + ii) != buf[ii]) {
+            EEPROM.write(offset + ii, buf[ii]);
+        }
+    }
+}
+
+void SmsTrace::add(Event event, uint8_t arg8, uint16_t arg16, uint32_t arg32) {
+    if (!numEntries) {
+        return;
+    }
+
+    ATOMIC_BLOCK() {
+        if (paused) {
+            droppedEvents++;
+        }
+        else {
+            // micros() wraps every 71.6 minutes. The 64-bit System.millis() tells how much time
+            // has passed since the last event, so pick the upper 32 bits that put the new value
+            // closest to that. This works no matter how long the gap between events is.
+            uint32_t us = micros();
+            uint64_t ms = System.millis();
+            uint64_t expected = lastMicros + (ms - lastMillis) * 1000;
+            uint64_t value = (expected & 0xffffffff00000000ULL) | us;
+            if (value + 0x80000000ULL < expected) {
+                value += 0x100000000ULL;
+            }
+            else if (value > expected + 0x80000000ULL && value >= 0x100000000ULL) {
+                value -= 0x100000000ULL;
+            }
+            lastMicros = value;
+            lastMillis = ms;
+
+            Entry *entry = &entries[nextEntry];
+            entry->micros = value;
+            entry->event = (uint8_t)event;
+            entry->arg8 = arg8;
+            entry->arg16 = arg16;
+            entry->arg32 = arg32;
+
+            if (++nextEntry >= numEntries) {
+                nextEntry = 0;
+            }
+            if (numUsed < numEntries) {
+                numUsed++;
+            }
+        }
+    }
+}
+
+void SmsTrace::addLoopTime(uint32_t microseconds) {
+    loopCount++;
+    loopTotalUs += microseconds;
+    if (microseconds > loopMaxUs) {
+        loopMaxUs = microseconds;
+    }
+
+    size_t bucket = 0;
+    while(bucket < LOOP_HISTOGRAM_SIZE - 1 && microseconds >= (1UL << bucket)) {
+        bucket++;
+    }
+    loopHistogram[bucket]++;
+
+    if (microseconds >= loopThresholdUs) {
+        add(Event::LOOP, 0, 0, microseconds);
+    }
+}
+
+void SmsTrace::clear() {
+    ATOMIC_BLOCK() {
+        nextEntry = numUsed = 0;
+    }
+    loopCount = loopMaxUs = 0;
+    loopTotalUs = 0;
+    memset(loopHistogram, 0, sizeof(loopHistogram));
+}
+
+void SmsTrace::dump(Print &out) {
+    // Pause recording so new events don't overwrite entries while they're being written out
+    size_t first, count;
+    ATOMIC_BLOCK() {
+        paused = true;
+        droppedEvents = 0;
+        count = numUsed;
+        first = numEntries ? (nextEntry + numEntries - numUsed) % numEntries : 0;
+    }
+
+    out.printf("SMSTRACE begin %u %lu %lu %lu\n", (unsigned int)count, (unsigned long)loopCount, (unsigned long)getLoopAvgUs(), (unsigned long)loopMaxUs);
+
+    out.printf("SMSTRACE hist");
+    for(size_t ii = 0; ii < LOOP_HISTOGRAM_SIZE; ii++) {
+        out.printf(" %lu", (unsigned long)loopHistogram[ii]);
+    }
+    out.printf("\n");
+
+    for(size_t ii = 0; ii < count; ii++) {
+        const Entry &entry = entries[(first + ii) % numEntries];
+        out.printf("SMSTRACE %08lx%08lx %02x %02x %04x %08lx\n", (unsigned long)(entry.micros >> 32), (unsigned long)(entry.micros & 0xffffffff), 
+            entry.event, entry.arg8, entry.arg16, (unsigned long)entry.arg32);
+    }
+
+    uint32_t dropped;
+    ATOMIC_BLOCK() {
+        paused = false;
+        dropped = droppedEvents;
+    }
+
+    out.printf("SMSTRACE end %lu\n", (unsigned long)dropped);
+}
+
 SmsMessageDelayed::SmsMessageDelayed() {
     SmsWebhook::instance().addDelayed(this);
 }
@@ -167,12 +444,20 @@ SmsMessageDelayed::~SmsMessageDelayed() {
 void SmsMessageDelayed::startWarning() {
     if (!warningStart) {
         warningStart = millis();
+        if (!warningStart) {
+            // 0 means not started
+            warningStart = 1;
+        }
         warned = false;
+        stateChanged();
     }
 }
 
 void SmsMessageDelayed::clearWarning() {
-    warningStart = 0;
+    if (warningStart) {
+        warningStart = 0;
+        stateChanged();
+    }
 }
 
 void SmsMessageDelayed::check() {
@@ -198,6 +483,60 @@ void SmsMessageDelayed::check() {
     }
 
     warned = millis();
+    stateChanged();
+
+    SmsWebhook::instance().addTrace(SmsTrace::Event::DELAYED_QUEUE, 0, persistId);
 
     SmsWebhook::instance().queueSms(*this);
 }
+
+void SmsMessageDelayed::stateChanged() {
+    if (persistId) {
+        SmsWebhook::instance().delayedStateChanged();
+    }
+}
+
+bool SmsMessageDelayed::saveState(SmsDelayedRecord &record, time_t now) const {
+    if (!warningStart) {
+        return false;
+    }
+
+    unsigned long ms = millis();
+
+    record.persistId = persistId;
+    record.reserved = 0;
+    record.warningStart = (uint32_t)(now - (time_t)((ms - warningStart) / 1000));
+    record.warned = warned ? (uint32_t)(now - (time_t)((ms - warned) / 1000)) : 0;
+
+    return true;
+}
+
+void SmsMessageDelayed::restoreState(const SmsDelayedRecord &record, time_t now) {
+    if (!record.warningStart) {
+        return;
+    }
+
+    // Convert the wall-clock times back to millis() values. Elapsed times are limited to
+    // 24 days so the unsigned millis() arithmetic does not wrap.
+    const unsigned long maxElapsedSec = 24UL * 24 * 60 * 60;
+    unsigned long ms = millis();
+
+    unsigned long elapsedSec = (now > (time_t)record.warningStart) ? (unsigned long)(now - record.warningStart) : 0;
+    unsigned long restoredStart = ms - std::min(elapsedSec, maxElapsedSec) * 1000;
+
+    if (!warningStart || (ms - restoredStart) > (ms - warningStart)) {
+        // Not warning yet, or the saved warning started earlier, so keep the earlier one
+        warningStart = restoredStart ? restoredStart : 1;
+    }
+
+    if (record.warned) {
+        elapsedSec = (now > (time_t)record.warned) ? (unsigned long)(now - record.warned) : 0;
+        unsigned long restoredWarned = ms - std::min(elapsedSec, maxElapsedSec) * 1000;
+
+        if (!warned || (ms - restoredWarned) < (ms - warned)) {
+            // Not warned yet, or the saved warning is more recent, so keep the later one. If the
+            // warning was already sent this boot, a restore must not make a repeat due sooner.
+            warned = restoredWarned ? restoredWarned : 1;
+        }
+    }
+}
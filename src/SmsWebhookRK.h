@@ -88,6 +88,122 @@ protected:
     String message;
 };
 
+/**
+ * @brief Saved state of one SmsMessageDelayed object (used internally)
+ *
+ * Times are stored as Unix time (seconds since January 1, 1970, UTC) instead of millis() values
+ * so they remain meaningful after a reset.
+ */
+struct SmsDelayedRecord {
+    uint16_t persistId;         //!< Value set by SmsMessageDelayed::withPersistId()
+    uint16_t reserved;          //!< Reserved, currently 0
+    uint32_t warningStart;      //!< Time the warning started, or 0 if not started
+    uint32_t warned;            //!< Time the warning SMS was last queued, or 0 if not yet warned
+};
+
+/**
+ * @brief Abstract base class for storing the state of SmsMessageDelayed objects across resets
+ *
+ * Use one of the subclasses SmsDelayedStorageRetained or SmsDelayedStorageEEPROM, or make your
+ * own subclass to store the data elsewhere, such as a file.
+ */
+class SmsDelayedStorage {
+public:
+    /**
+     * @brief Default constructor
+     */
+    SmsDelayedStorage() {};
+
+    /**
+     * @brief Default destructor
+     */
+    virtual ~SmsDelayedStorage() {};
+
+    /**
+     * @brief Number of bytes of storage available
+     */
+    virtual size_t getSize() const = 0;
+
+    /**
+     * @brief Read the saved data into buf
+     *
+     * @param buf Buffer to read into, getSize() bytes
+     */
+    virtual void load(uint8_t *buf) = 0;
+
+    /**
+     * @brief Save the data in buf
+     *
+     * @param buf Buffer to save, getSize() bytes
+     */
+    virtual void save(const uint8_t *buf) = 0;
+};
+
+/**
+ * @brief Store the state of SmsMessageDelayed objects in retained memory
+ *
+ * Retained memory survives a reset but not power loss. It's fast and does not wear out, so it's
+ * fine to save changes immediately (checkpoint interval of 0).
+ *
+ * ```
+ * retained uint8_t smsRetained[64];
+ *
+ * SmsWebhook::instance().withDelayedStorage(new SmsDelayedStorageRetained(smsRetained, sizeof(smsRetained)));
+ * ```
+ *
+ * On Gen 2 devices you must also enable retained memory using `STARTUP(System.enableFeature(FEATURE_RETAINED_MEMORY));`
+ */
+class SmsDelayedStorageRetained : public SmsDelayedStorage {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param retainedBuf Pointer to a buffer declared `retained`
+     *
+     * @param size Size of retainedBuf in bytes
+     */
+    SmsDelayedStorageRetained(void *retainedBuf, size_t size) : retainedBuf((uint8_t *)retainedBuf), size(size) {};
+
+    virtual size_t getSize() const { return size; };
+    virtual void load(uint8_t *buf) { memcpy(buf, retainedBuf, size); };
+    virtual void save(const uint8_t *buf) { memcpy(retainedBuf, buf, size); };
+
+protected:
+    uint8_t *retainedBuf; //!< Retained memory buffer
+    size_t size; //!< Size of retainedBuf in bytes
+};
+
+/**
+ * @brief Store the state of SmsMessageDelayed objects in emulated EEPROM
+ *
+ * This survives power loss. Only bytes that have changed are written, but you should still
+ * set a checkpoint interval (60000 milliseconds, for example) so multiple changes are batched
+ * into a single write. The first change after boot is always saved right away.
+ *
+ * ```
+ * SmsWebhook::instance().withDelayedStorage(new SmsDelayedStorageEEPROM(128, 64), 60000);
+ * ```
+ */
+class SmsDelayedStorageEEPROM : public SmsDelayedStorage {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param offset Offset in EEPROM to store the data
+     *
+     * @param size Number of bytes of EEPROM to use
+     */
+    SmsDelayedStorageEEPROM(size_t offset, size_t size) : offset(offset), size(size) {};
+
+    virtual size_t getSize() const { return size; };
+    virtual void load(uint8_t *buf);
+    virtual void save(const uint8_t *buf);
+
+protected:
+    size_t offset; //!< Offset in EEPROM
+    size_t size; //!< Number of bytes of EEPROM to use
+};
+
 /**
  * @brief Subclass of SmsMessage that delays before sending
  * 
@@ -122,6 +238,21 @@ public:
      */
     SmsMessageDelayed &withWarningRepeat(std::chrono::milliseconds value) { warningRepeat = value.count(); return *this; };
 
+    /**
+     * @brief Set an identifier used to save the warning state across resets. Default is 0 (not saved).
+     *
+     * @param persistId A non-zero value that is unique among your SmsMessageDelayed objects
+     *
+     * This only has an effect if you've also called SmsWebhook::withDelayedStorage(). The identifier
+     * must not change between firmware versions or the saved state will be applied to the wrong object.
+     */
+    SmsMessageDelayed &withPersistId(uint16_t persistId) { this->persistId = persistId; return *this; };
+
+    /**
+     * @brief Gets the identifier set using withPersistId()
+     */
+    uint16_t getPersistId() const { return persistId; };
+
     /**
      * @brief Starts the warning period
      * 
@@ -148,11 +279,201 @@ public:
      */
     unsigned long getElapsedMs() const { return warningStart ? millis() - warningStart : 0; };
 
+    /**
+     * @brief Saves the state to a record (used internally)
+     *
+     * @param record Filled in with the persistId and Unix time of the warning state
+     *
+     * @param now The current Unix time (Time.now())
+     *
+     * @return true if a warning is in progress, false if not (record is not modified)
+     */
+    bool saveState(SmsDelayedRecord &record, time_t now) const;
+
+    /**
+     * @brief Restores the state from a record (used internally)
+     *
+     * @param record A record previously filled in by saveState()
+     *
+     * @param now The current Unix time (Time.now())
+     */
+    void restoreState(const SmsDelayedRecord &record, time_t now);
+
 protected:
+    /**
+     * @brief Notifies SmsWebhook that state has changed, if this object is persisted
+     */
+    void stateChanged();
+
     unsigned long warningStart = 0;
     unsigned long warningWait = 0;
     unsigned long warningRepeat = 0;
     unsigned long warned = 0;
+    uint16_t persistId = 0;
+};
+
+/**
+ * @brief Fixed-size binary trace buffer for profiling SmsWebhook latency
+ *
+ * When enabled using SmsWebhook::withTrace(), state transitions, queue operations, recipient callbacks,
+ * and publish results are recorded with a microsecond timestamp. Recording an event is a few memory writes,
+ * much less expensive than logging. When the buffer is full, the oldest events are overwritten.
+ *
+ * The timestamp is micros() extended to 64 bits using System.millis(), so it does not wrap every
+ * 71 minutes like micros() does, and the timeline stays correct across long idle periods.
+ *
+ * The execution time of every SmsWebhook::loop() call is also recorded in a histogram, and calls that
+ * take at least the loop threshold are recorded as events.
+ *
+ * Use SmsTraceStatic to allocate the buffer:
+ *
+ * ```
+ * SmsTraceStatic<128> smsTrace;
+ *
+ * SmsWebhook::instance().withTrace(&smsTrace);
+ *
+ * // Later, for example from a button handler flag or Particle function
+ * smsTrace.dump(Serial);
+ * ```
+ *
+ * The output of dump() can be decoded using tools/trace-decode/trace-decode.js.
+ */
+class SmsTrace {
+public:
+    /**
+     * @brief Event types. The meaning of arg8, arg16 and arg32 depends on the event.
+     */
+    enum class Event : uint8_t {
+        STATE = 1,          //!< State transition. arg8 = new state (STATE_XXX constant)
+        QUEUE_PUSH,         //!< Message queued. arg16 = queue size after, arg32 = message length
+        QUEUE_POP,          //!< Message removed after successful publish. arg16 = queue size after
+        RECIPIENT,          //!< Recipient callback called. arg8 = 1 if known, arg32 = callback time in microseconds
+        PUBLISH_START,      //!< Particle.publish called. arg16 = data length
+        PUBLISH_RESULT,     //!< Publish completed. arg8 = 1 if succeeded, arg32 = time to ACK in milliseconds
+        LOOP,               //!< Slow loop call. arg32 = execution time in microseconds
+        DELAYED_QUEUE       //!< SmsMessageDelayed queued its message. arg16 = persist ID
+    };
+
+    static const uint8_t STATE_WAIT_FOR_MESSAGE = 1; //!< stateWaitForMessage
+    static const uint8_t STATE_WAIT_PUBLISH = 2; //!< stateWaitPublish
+    static const uint8_t STATE_WAIT_RETRY = 3; //!< stateWaitRetry
+
+    /**
+     * @brief Number of buckets in the loop time histogram
+     *
+     * Bucket n counts loop calls that took less than 2^n microseconds (and at least 2^(n-1)). The last
+     * bucket counts all longer calls.
+     */
+    static const size_t LOOP_HISTOGRAM_SIZE = 20;
+
+    /**
+     * @brief One trace record (16 bytes)
+     */
+    struct Entry {
+        uint64_t micros;    //!< Microseconds since boot when the event was recorded
+        uint8_t event;      //!< Event type (Event enum)
+        uint8_t arg8;       //!< Event-specific value
+        uint16_t arg16;     //!< Event-specific value
+        uint32_t arg32;     //!< Event-specific value
+    };
+
+    /**
+     * @brief Constructor. You normally use SmsTraceStatic instead.
+     *
+     * @param entries Buffer of entries. This is not copied and must remain valid.
+     *
+     * @param numEntries Number of entries in the buffer
+     */
+    SmsTrace(Entry *entries, size_t numEntries) : entries(entries), numEntries(numEntries) {};
+
+    /**
+     * @brief Destructor
+     */
+    virtual ~SmsTrace() {};
+
+    /**
+     * @brief Sets the loop() execution time to record as a LOOP event. Default is 1000 microseconds.
+     *
+     * @param microseconds New value in microseconds
+     *
+     * Every loop call is counted in the histogram; this only determines which are also recorded in the trace.
+     */
+    SmsTrace &withLoopThresholdUs(uint32_t microseconds) { loopThresholdUs = microseconds; return *this; };
+
+    /**
+     * @brief Record an event. Safe to call from any thread.
+     *
+     * Events added while dump() is running are discarded and counted, so they don't overwrite entries
+     * that are being written out.
+     */
+    void add(Event event, uint8_t arg8 = 0, uint16_t arg16 = 0, uint32_t arg32 = 0);
+
+    /**
+     * @brief Record the execution time of a loop() call (used internally)
+     */
+    void addLoopTime(uint32_t microseconds);
+
+    /**
+     * @brief Remove all events and reset the loop statistics
+     */
+    void clear();
+
+    /**
+     * @brief Write the trace and loop statistics as text lines beginning with "SMSTRACE"
+     *
+     * @param out Where to write, for example Serial.
+     *
+     * Entries are written oldest first. Recording is paused during the dump; the number of events
+     * discarded while paused is written on the end line.
+     */
+    void dump(Print &out);
+
+    /**
+     * @brief Number of loop() calls counted
+     */
+    uint32_t getLoopCount() const { return loopCount; };
+
+    /**
+     * @brief Longest loop() call in microseconds
+     */
+    uint32_t getLoopMaxUs() const { return loopMaxUs; };
+
+    /**
+     * @brief Average loop() call in microseconds
+     */
+    uint32_t getLoopAvgUs() const { return loopCount ? (uint32_t)(loopTotalUs / loopCount) : 0; };
+
+protected:
+    Entry *entries; //!< Buffer of entries
+    size_t numEntries; //!< Number of entries in the buffer
+    size_t nextEntry = 0; //!< Index to write the next entry to
+    size_t numUsed = 0; //!< Number of valid entries, up to numEntries
+    uint32_t loopThresholdUs = 1000; //!< loop calls at least this long are added as LOOP events
+    uint32_t loopCount = 0; //!< Number of loop calls
+    uint32_t loopMaxUs = 0; //!< Longest loop call
+    uint64_t loopTotalUs = 0; //!< Total time in loop calls, for the average
+    uint32_t loopHistogram[LOOP_HISTOGRAM_SIZE] = {0}; //!< Loop time histogram, power of 2 microsecond buckets
+    uint64_t lastMicros = 0; //!< Extended micros() value of the last event
+    uint64_t lastMillis = 0; //!< System.millis() value of the last event
+    volatile bool paused = false; //!< true while dump() is running
+    uint32_t droppedEvents = 0; //!< Events discarded because dump() was running
+};
+
+/**
+ * @brief SmsTrace with a statically allocated buffer
+ *
+ * @param NUM_ENTRIES Number of events to keep. Each entry is 16 bytes.
+ */
+template<size_t NUM_ENTRIES>
+class SmsTraceStatic : public SmsTrace {
+public:
+    /**
+     * @brief Constructor
+     */
+    SmsTraceStatic() : SmsTrace(staticEntries, NUM_ENTRIES) {};
+
+protected:
+    Entry staticEntries[NUM_ENTRIES]; //!< Buffer of entries
 };
 
 /**
@@ -304,6 +625,75 @@ public:
      */
     unsigned long getPublishRateLimitMs() const { return publishRateLimitMs; };
 
+    /**
+     * @brief Enables adaptive pacing of publishes, between floorMs and ceilingMs
+     *
+     * @param floorMs Minimum time between publishes in milliseconds. Default is 1010 milliseconds.
+     *
+     * @param ceilingMs Maximum time between publishes (or publish retries) in milliseconds. Default is 60 seconds.
+     *
+     * @return *this, so you can chain this function fluent-style.
+     *
+     * Instead of the fixed publish rate limit and publish fail retry times, the time between publishes
+     * is adjusted based on the results (AIMD, additive increase, multiplicative decrease, of the send rate):
+     *
+     * - A successful publish with a fast average ACK increases the send rate by the rate step
+     *   (withAdaptivePacingRateStep(), publishes per minute).
+     * - A successful publish when the average ACK time is slow (withAdaptivePacingSlowAckMs()) decreases the
+     *   send rate by the rate step instead.
+     * - A failed publish multiplies the interval by 1 + the recent failure rate (getPublishFailPct()), so between
+     *   1x for an occasional failure and 2x when every publish is failing. The interval after a failure is never
+     *   less than the publish fail retry time (withRetryPublishFailMs()), and the publish is retried after the
+     *   new interval.
+     *
+     * Because the increase is additive in rate, recovering from the ceiling to the floor takes a bounded number
+     * of publishes (about 10 with the defaults).
+     *
+     * The interval starts at the publish rate limit (withPublishRateLimitMs()), limited to the floor and ceiling.
+     * The floor should not be less than 1000 milliseconds, the Particle publish rate limit. The ceiling takes
+     * precedence over the publish fail retry time if it's smaller.
+     */
+    SmsWebhook &withAdaptivePacing(unsigned long floorMs = 1010, unsigned long ceilingMs = 60000);
+
+    /**
+     * @brief Sets the amount the adaptive pacing send rate changes after each successful publish. Default is 6 publishes per minute.
+     *
+     * @param publishesPerMinute New value in publishes per minute
+     */
+    SmsWebhook &withAdaptivePacingRateStep(unsigned int publishesPerMinute) { adaptiveRateStep = publishesPerMinute; return *this; };
+
+    /**
+     * @brief Sets the average ACK time that is considered slow for adaptive pacing. Default is 5 seconds.
+     *
+     * @param milliseconds New value in milliseconds
+     *
+     * When the average time for the publish to be acknowledged by the cloud is greater than this, the
+     * link is considered to be congested and the publish interval is increased instead of decreased.
+     */
+    SmsWebhook &withAdaptivePacingSlowAckMs(unsigned long milliseconds) { adaptiveSlowAckMs = milliseconds; return *this; };
+
+    /**
+     * @brief Gets the current time between publishes in milliseconds
+     *
+     * This is the adaptive pacing interval if enabled, otherwise the publish rate limit.
+     */
+    unsigned long getPacingIntervalMs() const { return adaptivePacing ? pacingIntervalMs : publishRateLimitMs; };
+
+    /**
+     * @brief Gets the average time for a publish to complete in milliseconds
+     *
+     * This is a moving average of the time from `Particle.publish()` until it succeeds. Failed publishes
+     * are not included, as they typically take the full ACK timeout.
+     */
+    unsigned long getAvgAckMs() const { return avgAckMs; };
+
+    /**
+     * @brief Gets the recent publish failure rate in percent (0 - 100)
+     *
+     * This is a moving average, so recent publishes count more.
+     */
+    unsigned int getPublishFailPct() const { return (publishFailRate + 500) / 1000; };
+
     /**
      * @brief Regisers a delayed message (used internally)
      * 
@@ -317,6 +707,54 @@ public:
      * You should never need to use this as SmsMessageDelayed calls this from its desstructor.
      */
     void removeDelayed(SmsMessageDelayed *obj);
+
+    /**
+     * @brief Sets where to save the state of SmsMessageDelayed objects so warnings survive a reset
+     *
+     * @param storage The storage object, typically a new SmsDelayedStorageRetained or SmsDelayedStorageEEPROM.
+     * This object is not copied and must remain valid.
+     *
+     * @param checkpointIntervalMs Minimum time between saves in milliseconds. Default is 0 (save on the
+     * next loop after a change).
+     *
+     * @return *this, so you can chain this function fluent-style.
+     *
+     * Only SmsMessageDelayed objects with a non-zero withPersistId() are saved. Because the times are
+     * saved as wall-clock time, nothing is restored or saved until `Time.isValid()` is true. Once it is,
+     * the saved state is restored to the SmsMessageDelayed objects that exist at that time.
+     *
+     * The first change after boot is saved right away. Later changes within checkpointIntervalMs of the
+     * previous save are combined into a single save at the end of the interval. If the device resets
+     * before then, those changes are lost, so don't make the interval longer than the time between
+     * resets you need to handle.
+     *
+     * The buffer used to build the saved data (getSize() bytes) is allocated once, by this call.
+     */
+    SmsWebhook &withDelayedStorage(SmsDelayedStorage *storage, unsigned long checkpointIntervalMs = 0);
+
+    /**
+     * @brief Notifies that the state of a persisted SmsMessageDelayed changed (used internally)
+     */
+    void delayedStateChanged() { checkpointDirty = true; };
+
+    /**
+     * @brief Enables recording events to a trace buffer
+     *
+     * @param trace The trace buffer, typically a global SmsTraceStatic object. This object is not copied
+     * and must remain valid. Pass NULL to stop tracing.
+     *
+     * @return *this, so you can chain this function fluent-style.
+     */
+    SmsWebhook &withTrace(SmsTrace *trace) { this->trace = trace; return *this; };
+
+    /**
+     * @brief Records an event in the trace buffer, if enabled (used internally)
+     */
+    void addTrace(SmsTrace::Event event, uint8_t arg8 = 0, uint16_t arg16 = 0, uint32_t arg32 = 0) {
+        if (trace) {
+            trace->add(event, arg8, arg16, arg32);
+        }
+    };
     
 protected:
     /**
@@ -358,6 +796,20 @@ protected:
      */
     void stateWaitRetry();
 
+    /**
+     * @brief Updates the publish statistics and adaptive pacing interval from stateWaitPublish()
+     *
+     * @param success true if the publish succeeded
+     *
+     * @param ackMs Time from `Particle.publish()` until it completed in milliseconds
+     */
+    void updatePacing(bool success, unsigned long ackMs);
+
+    /**
+     * @brief Restores and saves the SmsMessageDelayed state, if necessary. Called from setup() and loop().
+     */
+    void checkDelayedStorage();
+
     /**
      * @brief Event name to use. Default is "SendSmsEvent". Use withEventName() to change.
      */
@@ -415,6 +867,48 @@ protected:
      */
     unsigned long publishRateLimitMs = 1010;
 
+    /**
+     * @brief true if adaptive pacing is enabled. Use withAdaptivePacing() to enable.
+     */
+    bool adaptivePacing = false;
+
+    /**
+     * @brief Minimum adaptive pacing interval in milliseconds
+     */
+    unsigned long adaptiveFloorMs = 1010;
+
+    /**
+     * @brief Maximum adaptive pacing interval in milliseconds
+     */
+    unsigned long adaptiveCeilingMs = 60000;
+
+    /**
+     * @brief Amount the adaptive pacing send rate changes after a successful publish in publishes per minute
+     */
+    unsigned int adaptiveRateStep = 6;
+
+    /**
+     * @brief Average ACK time considered to be slow for adaptive pacing in milliseconds
+     */
+    unsigned long adaptiveSlowAckMs = 5000;
+
+    /**
+     * @brief Current adaptive pacing interval in milliseconds
+     */
+    unsigned long pacingIntervalMs = 0;
+
+    /**
+     * @brief Moving average of the successful publish ACK time in milliseconds (0 until the first publish succeeds)
+     */
+    unsigned long avgAckMs = 0;
+
+    /**
+     * @brief Moving average of the publish failure rate in thousandths of a percent (0 - 100000)
+     *
+     * The extra precision keeps the integer moving average from stopping short of 0 or 100 percent.
+     */
+    int32_t publishFailRate = 0;
+
     /**
      * @brief Sets the temporary buffer for the JSON data for the publish
      * 
@@ -439,6 +933,53 @@ protected:
      */
     std::vector<SmsMessageDelayed *> delayedMessages;
 
+    /**
+     * @brief Where to save SmsMessageDelayed state. Use withDelayedStorage() to change. Default: none
+     */
+    SmsDelayedStorage *delayedStorage = 0;
+
+    /**
+     * @brief Minimum time between saves of SmsMessageDelayed state in milliseconds
+     */
+    unsigned long checkpointIntervalMs = 0;
+
+    /**
+     * @brief millis() value when SmsMessageDelayed state was last saved
+     */
+    unsigned long lastCheckpoint = 0;
+
+    /**
+     * @brief true if SmsMessageDelayed state has been saved since boot
+     *
+     * The first save is not delayed by checkpointIntervalMs, since millis() restarts at 0 on every boot.
+     */
+    bool hasCheckpointed = false;
+
+    /**
+     * @brief Buffer for loading and saving SmsMessageDelayed state, delayedStorage->getSize() bytes
+     */
+    uint8_t *checkpointBuf = 0;
+
+    /**
+     * @brief true if SmsMessageDelayed state has changed since it was last saved
+     */
+    bool checkpointDirty = false;
+
+    /**
+     * @brief true if saved SmsMessageDelayed state has not been restored yet
+     */
+    bool restorePending = false;
+
+    /**
+     * @brief Magic bytes at the beginning of saved SmsMessageDelayed state
+     */
+    static const uint32_t DELAYED_MAGIC = 0x534d5331;
+
+    /**
+     * @brief Trace buffer. Use withTrace() to change. Default: none
+     */
+    SmsTrace *trace = 0;
+
     /**
      * @brief Singleton instance of this class
      * 
@@ -0,0 +1,388 @@
+#ifndef __SMSWEBHOOKSTATICRK_H
+#define __SMSWEBHOOKSTATICRK_H
+
+// Github: https://github.com/rickkas7/SmsWebhookRK
+// License: MIT
+
+#include "Particle.h"
+
+/**
+ * @brief Default compile-time policy for SmsWebhookT
+ *
+ * To change a setting, make your own struct that inherits from this one and
+ * override only the members you want to change:
+ *
+ * ```
+ * struct MySmsPolicy : public SmsWebhookDefaultPolicy {
+ *     static const char *eventName() { return "MySmsEvent"; };
+ *     static constexpr unsigned long retryPublishFailMs = 30000;
+ * };
+ * ```
+ */
+struct SmsWebhookDefaultPolicy {
+    /**
+     * @brief Event name to use. This must match the webhook. Default is "SendSmsEvent".
+     */
+    static const char *eventName() { return "SendSmsEvent"; };
+
+    /**
+     * @brief Retry time when no recipient is known in milliseconds. Default is 15 seconds.
+     */
+    static constexpr unsigned long retryNoRecipientMs = 15000;
+
+    /**
+     * @brief Retry time if the publish fails in milliseconds. Default is 15 seconds.
+     */
+    static constexpr unsigned long retryPublishFailMs = 15000;
+
+    /**
+     * @brief Publish rate limit in milliseconds. Default is 1010 milliseconds.
+     */
+    static constexpr unsigned long publishRateLimitMs = 1010;
+};
+
+/**
+ * @brief Compile-time configured version of SmsWebhook that does not use the heap
+ *
+ * @param QUEUE_DEPTH Maximum number of messages that can be queued to send
+ *
+ * @param MAX_BODY Maximum length of the message text, not including the null terminator
+ *
+ * @param MAX_RECIPIENT Maximum length of the recipient phone number, not including the null terminator
+ *
+ * @param Policy A struct containing the event name and timing values. See SmsWebhookDefaultPolicy.
+ *
+ * The library's own storage, including the queue, is static so its RAM usage is known at compile
+ * time. Particle.publish() and the Future it returns still allocate memory inside Device OS.
+ * It's intended for devices where RAM is tight; the SmsWebhook class is easier to use and
+ * supports SmsMessageDelayed, which this class does not.
+ *
+ * Because each set of template parameters is a separate class, it's best to make a typedef:
+ *
+ * ```
+ * typedef SmsWebhookT<4, 160, 16> SmsWebhookStatic;
+ *
+ * void setup() {
+ *     SmsWebhookStatic::instance().setup();
+ * }
+ *
+ * void loop() {
+ *     SmsWebhookStatic::instance().loop();
+ * }
+ *
+ * SmsWebhookStatic::instance().queueSms("+12125551212", "testing!");
+ * ```
+ */
+template<size_t QUEUE_DEPTH = 4, size_t MAX_BODY = 160, size_t MAX_RECIPIENT = 20, class Policy = SmsWebhookDefaultPolicy>
+class SmsWebhookT {
+public:
+    static_assert(QUEUE_DEPTH > 0, "QUEUE_DEPTH must be at least 1");
+    static_assert(MAX_BODY > 0, "MAX_BODY must be at least 1");
+
+    /**
+     * @brief Recipient callback function prototype
+     *
+     * @param buf Buffer to copy the recipient phone number into (+ country code format)
+     *
+     * @param bufSize Size of buf in bytes, including room for the null terminator (MAX_RECIPIENT + 1)
+     *
+     * Return true if the recipient is known, or false if not. If false is returned, then an attempt will
+     * be made again after Policy::retryNoRecipientMs.
+     */
+    typedef bool (*RecipientCallback)(char *buf, size_t bufSize);
+
+    /**
+     * @brief Get the singleton instance of this class
+     *
+     * The instance is a function-local static, not allocated on the heap. It's constructed on the
+     * first call, so it's safe to call this from a global constructor.
+     */
+    static SmsWebhookT &instance() {
+        static SmsWebhookT _instance;
+        return _instance;
+    };
+
+    /**
+     * @brief You must call setup() from global application setup()!
+     */
+    void setup() {
+        os_mutex_create(&sendQueueMutex);
+        state = State::WAIT_FOR_MESSAGE;
+    };
+
+    /**
+     * @brief You must call loop() from global application loop()!
+     */
+    void loop() {
+        switch(state) {
+            case State::WAIT_FOR_MESSAGE:
+                stateWaitForMessage();
+                break;
+
+            case State::WAIT_PUBLISH:
+                stateWaitPublish();
+                break;
+
+            case State::WAIT_RETRY:
+                stateWaitRetry();
+                break;
+
+            default:
+                break;
+        }
+    };
+
+    /**
+     * @brief Queue a SMS message to send
+     *
+     * @param recipient Recipient phone number in + country code format, or NULL or "" to use the
+     * recipient callback (or the phone number in the webhook).
+     *
+     * @param message The SMS message text
+     *
+     * @return true if the message was queued, or false if the queue is full, setup() has not been
+     * called, or the recipient or message is too long to fit.
+     *
+     * The strings are copied by this call. It's safe to make this call from other threads.
+     */
+    bool queueSms(const char *recipient, const char *message) {
+        if (!sendQueueMutex) {
+            return false;
+        }
+        if (!recipient) {
+            recipient = "";
+        }
+        if (!message) {
+            message = "";
+        }
+        if (strlen(recipient) > MAX_RECIPIENT || strlen(message) > MAX_BODY) {
+            return false;
+        }
+
+        bool result = false;
+
+        os_mutex_lock(sendQueueMutex);
+        if (queueCount < QUEUE_DEPTH) {
+            Entry &entry = sendQueue[(queueHead + queueCount) % QUEUE_DEPTH];
+            strcpy(entry.recipient, recipient);
+            strcpy(entry.message, message);
+            queueCount++;
+            result = true;
+        }
+        os_mutex_unlock(sendQueueMutex);
+
+        return result;
+    };
+
+    /**
+     * @brief Returns the number of messages waiting to be sent
+     */
+    size_t getQueueCount() const { return queueCount; };
+
+    /**
+     * @brief Get the event name from the policy
+     */
+    const char *getEventName() const { return Policy::eventName(); };
+
+    /**
+     * @brief Sets a function to call to get the recipient if the queued recipient is empty
+     *
+     * @param recipientCallback the function to call to find the recipient
+     *
+     * @return *this, so you can chain this function fluent-style.
+     *
+     * Unlike SmsWebhook, this is a plain function pointer, not a std::function, so it can't be a
+     * capturing lambda.
+     */
+    SmsWebhookT &withRecipientCallback(RecipientCallback recipientCallback) { this->recipientCallback = recipientCallback; return *this; };
+
+protected:
+    /**
+     * @brief Constructor (protected)
+     *
+     * You never construct one of these - use the singleton instance using `instance()`.
+     */
+    SmsWebhookT() {};
+
+    /**
+     * @brief This class is not copyable
+     */
+    SmsWebhookT(const SmsWebhookT&) = delete;
+
+    /**
+     * @brief This class is not copyable
+     */
+    SmsWebhookT& operator=(const SmsWebhookT&) = delete;
+
+    /**
+     * @brief States for the main state machine, dispatched by loop()
+     */
+    enum class State {
+        NOT_STARTED,        //!< setup() has not been called
+        WAIT_FOR_MESSAGE,   //!< stateWaitForMessage()
+        WAIT_PUBLISH,       //!< stateWaitPublish()
+        WAIT_RETRY          //!< stateWaitRetry()
+    };
+
+    /**
+     * @brief A queued message
+     */
+    struct Entry {
+        char recipient[MAX_RECIPIENT + 1]; //!< Recipient phone number, or empty to use the callback
+        char message[MAX_BODY + 1]; //!< Message text
+    };
+
+    /**
+     * @brief State handler for waiting for a message and cloud connected
+     */
+    void stateWaitForMessage() {
+        if (!queueCount || !Particle.connected()) {
+            // No message to send OR
+            // Not cloud connected, can't send event
+            return;
+        }
+
+        // Only loop() removes entries, so the front entry remains valid while unlocked
+        os_mutex_lock(sendQueueMutex);
+        const Entry &entry = sendQueue[queueHead];
+        os_mutex_unlock(sendQueueMutex);
+
+        char recipient[MAX_RECIPIENT + 1];
+        recipient[0] = 0;
+
+        if (entry.recipient[0] == 0) {
+            if (recipientCallback && !recipientCallback(recipient, sizeof(recipient))) {
+                // Don't know the recipient yet; try again after timeout
+                _log.info("no recipient");
+                stateTime = millis();
+                retryTimeMs = Policy::retryNoRecipientMs;
+                state = State::WAIT_RETRY;
+                return;
+            }
+            recipient[MAX_RECIPIENT] = 0;
+        }
+        else {
+            strcpy(recipient, entry.recipient);
+        }
+
+        char jsonBuf[JSON_BUF_SIZE];
+        JSONBufferWriter writer(jsonBuf, JSON_BUF_SIZE - 1);
+
+        writer.beginObject();
+        writer.name("b").value(entry.message);
+        if (recipient[0]) {
+            writer.name("t").value(recipient);
+        }
+        writer.endObject();
+        writer.buffer()[std::min(writer.bufferSize(), writer.dataSize())] = 0;
+
+        _log.info("publishing %s", jsonBuf);
+
+        // Have a message and are connected
+        publishFuture = Particle.publish(Policy::eventName(), jsonBuf, PRIVATE | WITH_ACK);
+
+        stateTime = millis();
+        state = State::WAIT_PUBLISH;
+    };
+
+    /**
+     * @brief State handler for waiting for publish to complete
+     */
+    void stateWaitPublish() {
+        if (publishFuture.isDone()) {
+            if (publishFuture.isSucceeded()) {
+                _log.info("successfully published");
+                os_mutex_lock(sendQueueMutex);
+                queueHead = (queueHead + 1) % QUEUE_DEPTH;
+                queueCount--;
+                os_mutex_unlock(sendQueueMutex);
+                retryTimeMs = Policy::publishRateLimitMs;
+            }
+            else {
+                _log.info("failed to publish, will try again");
+                retryTimeMs = Policy::retryPublishFailMs;
+            }
+            stateTime = millis();
+            state = State::WAIT_RETRY;
+        }
+    };
+
+    /**
+     * @brief State handler for waiting for to retry
+     */
+    void stateWaitRetry() {
+        if (millis() - stateTime >= retryTimeMs) {
+            state = State::WAIT_FOR_MESSAGE;
+        }
+    };
+
+    /**
+     * @brief Size of the temporary buffer for the JSON data for the publish
+     *
+     * This is allocated on the stack from loop(). It allows the message text to double in size
+     * from JSON escaping, plus the recipient and the JSON keys and punctuation.
+     */
+    static const size_t JSON_BUF_SIZE = 2 * MAX_BODY + MAX_RECIPIENT + 16;
+
+    /**
+     * @brief Maximum publish event data size in bytes on the smallest devices
+     *
+     * A larger event would be rejected by Particle.publish() every time, and because the queue
+     * head is only removed after a successful publish, it would block every message behind it.
+     */
+    static const size_t MAX_EVENT_DATA_SIZE = 622;
+
+    static_assert(JSON_BUF_SIZE - 1 <= MAX_EVENT_DATA_SIZE, "2 * MAX_BODY + MAX_RECIPIENT + 15 must not exceed the 622 byte publish limit");
+
+    /**
+     * @brief Current state, dispatched by loop()
+     */
+    State state = State::NOT_STARTED;
+
+    /**
+     * @brief Recipient callback. Use withRecipientCallback() to change. Default: none
+     */
+    RecipientCallback recipientCallback = 0;
+
+    /**
+     * @brief Mutex to protect sendQueue from access from multiple threads simultaneously
+     */
+    os_mutex_t sendQueueMutex = 0;
+
+    /**
+     * @brief Circular buffer of messages to send
+     */
+    Entry sendQueue[QUEUE_DEPTH];
+
+    /**
+     * @brief Index into sendQueue of the next message to send
+     */
+    size_t queueHead = 0;
+
+    /**
+     * @brief Number of messages in sendQueue
+     */
+    volatile size_t queueCount = 0;
+
+    /**
+     * @brief Future used to monitor the state of `Particle.publish()`.
+     */
+    particle::Future<bool> publishFuture;
+
+    /**
+     * @brief millis() value used for various timing purposes. This is always the start time.
+     */
+    unsigned long stateTime = 0;
+
+    /**
+     * @brief How long to wait for retry in stateWaitRetry.
+     */
+    unsigned long retryTimeMs = 0;
+
+    /**
+     * @brief Logger, shares the "sms" category with SmsWebhook
+     */
+    Logger _log{"sms"};
+};
+
+#endif /* __SMSWEBHOOKSTATICRK_H */
@@ -0,0 +1,59 @@
+// Fixed-size latency histogram for mock-cloud.js and load-test.js
+//
+// Github: https://github.com/rickkas7/SmsWebhookRK
+// License: MIT
+//
+// Soak tests can run for days, so samples are counted in logarithmic buckets (8 per power of 2,
+// about 9% resolution) instead of being kept in an array. Memory use is constant.
+
+const SUB_BUCKETS = 8;
+const NUM_BUCKETS = 32 * SUB_BUCKETS;
+
+class Histogram {
+    constructor() {
+        this.buckets = new Array(NUM_BUCKETS).fill(0);
+        this.count = 0;
+        this.max = 0;
+    }
+
+    static bucketIndex(value) {
+        return Math.min(NUM_BUCKETS - 1, Math.floor(Math.log2(value + 1) * SUB_BUCKETS));
+    }
+
+    // Upper bound of the values counted in a bucket
+    static bucketValue(index) {
+        return Math.round(Math.pow(2, (index + 1) / SUB_BUCKETS) - 1);
+    }
+
+    add(value) {
+        this.buckets[Histogram.bucketIndex(value)]++;
+        this.count++;
+        this.max = Math.max(this.max, value);
+    }
+
+    percentile(p) {
+        if (this.count == 0) {
+            return 0;
+        }
+        const target = Math.ceil(this.count * p / 100);
+        let sum = 0;
+        for (let ii = 0; ii < NUM_BUCKETS; ii++) {
+            sum += this.buckets[ii];
+            if (sum >= target) {
+                return Math.min(Histogram.bucketValue(ii), this.max);
+            }
+        }
+        return this.max;
+    }
+
+    summary() {
+        return { count: this.count, p50: this.percentile(50), p90: this.percentile(90), p99: this.percentile(99), max: this.max };
+    }
+
+    toString() {
+        const s = this.summary();
+        return 'p50=' + s.p50 + ' p90=' + s.p90 + ' p99=' + s.p99 + ' max=' + s.max;
+    }
+}
+
+module.exports = Histogram;
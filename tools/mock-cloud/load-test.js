@@ -0,0 +1,146 @@
+#!/usr/bin/env node
+// Load and soak test driver for mock-cloud.js
+//
+// Github: https://github.com/rickkas7/SmsWebhookRK
+// License: MIT
+//
+// Simulates one or more devices using a JavaScript model of the library's fixed-interval pacing.
+// It does not run the C++ code, and does not model withAdaptivePacing(). Messages are queued at
+// --queue-rate per second, and each device publishes the front of its queue with the same JSON
+// payload as stateWaitForMessage(), waits for the ACK like stateWaitPublish(), then waits
+// --rate-limit-ms after success or --retry-ms after failure like stateWaitRetry().
+//
+// Usage: node load-test.js [--url http://localhost:8080] [--devices 1] [--duration-sec 60]
+//        [--queue-rate 1] [--event SendSmsEvent] [--to +12125551212] [--rate-limit-ms 1010] [--retry-ms 15000]
+
+const http = require('http');
+const querystring = require('querystring');
+const Histogram = require('./histogram');
+
+const config = {
+    url: 'http://localhost:8080',
+    devices: 1,
+    durationSec: 60,
+    queueRate: 1,
+    event: 'SendSmsEvent',
+    to: '+12125551212',
+    rateLimitMs: 1010,
+    retryMs: 15000,
+};
+
+for (let ii = 2; ii < process.argv.length; ii++) {
+    const arg = process.argv[ii];
+    const key = arg.substring(2).replace(/-([a-z])/g, (m, c) => c.toUpperCase());
+    if (!arg.startsWith('--') || !(key in config) || ii + 1 >= process.argv.length) {
+        console.log('unknown option ' + arg);
+        process.exit(1);
+    }
+    const value = process.argv[++ii];
+    config[key] = (typeof config[key] === 'number') ? parseFloat(value) : value;
+}
+
+const baseUrl = new URL(config.url);
+
+const totals = { queued: 0, published: 0, failed: 0, ackLatencyMs: new Histogram(), queueDelayMs: new Histogram() };
+
+function request(method, path, body) {
+    return new Promise((resolve) => {
+        const req = http.request({
+            hostname: baseUrl.hostname,
+            port: baseUrl.port,
+            path,
+            method,
+            headers: body ? {
+                'Content-Type': 'application/x-www-form-urlencoded',
+                'Content-Length': Buffer.byteLength(body),
+            } : {},
+        }, (res) => {
+            let data = '';
+            res.on('data', (chunk) => data += chunk);
+            res.on('end', () => resolve({ statusCode: res.statusCode, data }));
+        });
+        req.on('error', (err) => resolve({ statusCode: 0, data: err.message }));
+        req.end(body);
+    });
+}
+
+function delay(ms) {
+    return new Promise((resolve) => setTimeout(resolve, ms));
+}
+
+class Device {
+    constructor(index) {
+        this.index = index;
+        this.counter = 0;
+        this.queue = [];
+    }
+
+    queueSms() {
+        this.queue.push({ b: 'Device ' + this.index + ' message ' + (++this.counter) + '!', t: config.to, queuedAt: Date.now() });
+        totals.queued++;
+    }
+
+    async run(endTime) {
+        while (Date.now() < endTime) {
+            if (this.queue.length == 0) {
+                await delay(10);
+                continue;
+            }
+            const msg = this.queue[0];
+            const startTime = Date.now();
+
+            const result = await request('POST', '/v1/devices/events', querystring.stringify({
+                name: config.event,
+                deviceId: 'device' + this.index,
+                data: JSON.stringify({ b: msg.b, t: msg.t }),
+                private: 'true',
+            }));
+
+            if (result.statusCode == 200) {
+                totals.published++;
+                totals.ackLatencyMs.add(Date.now() - startTime);
+                totals.queueDelayMs.add(Date.now() - msg.queuedAt);
+                this.queue.shift();
+                await delay(config.rateLimitMs);
+            }
+            else {
+                totals.failed++;
+                await delay(config.retryMs);
+            }
+        }
+    }
+}
+
+async function run() {
+    const endTime = Date.now() + config.durationSec * 1000;
+    const devices = [];
+    for (let ii = 0; ii < config.devices; ii++) {
+        devices.push(new Device(ii));
+    }
+
+    const queueTimer = setInterval(() => {
+        devices.forEach((device) => device.queueSms());
+    }, 1000 / config.queueRate);
+
+    const progressTimer = setInterval(() => {
+        const backlog = devices.reduce((sum, device) => sum + device.queue.length, 0);
+        console.log('queued=' + totals.queued + ' published=' + totals.published + ' failed=' + totals.failed + ' backlog=' + backlog);
+    }, 10000);
+
+    await Promise.all(devices.map((device) => device.run(endTime)));
+    clearInterval(queueTimer);
+    clearInterval(progressTimer);
+
+    // Give the last webhooks time to complete
+    await delay(2000);
+
+    const backlog = devices.reduce((sum, device) => sum + device.queue.length, 0);
+    console.log('queued=' + totals.queued + ' published=' + totals.published + ' failed=' + totals.failed + ' backlog=' + backlog);
+    console.log('publish ack latency ms: ' + totals.ackLatencyMs);
+    console.log('queue to ack delay ms: ' + totals.queueDelayMs);
+
+    const stats = await request('GET', '/stats');
+    console.log('mock cloud stats: ' + stats.data);
+}
+
+run();
@@ -0,0 +1,371 @@
+#!/usr/bin/env node
+// Local stand-in for the Particle cloud webhook and the Twilio Messages API
+//
+// Github: https://github.com/rickkas7/SmsWebhookRK
+// License: MIT
+//
+// Accepts events published to /v1/devices/events (the same fields as the Particle cloud API),
+// applies the webhook configuration from the README (form fields From, To={{{t}}}, Body={{{b}}}),
+// and sends the result to an emulated Twilio Messages API on the same server. Only built-in
+// node modules are used, so there's no npm install step.
+//
+// Usage: node mock-cloud.js [--port 8080] [--event SendSmsEvent] [--from +15005550006] [--to {{{t}}}]
+//        [--twilio-rate 1] [--twilio-concurrency 100] [--twilio-queue-sec 14400] [--publish-rate 1]
+//        [--publish-burst 4] [--error-rate 0] [--latency-ms 0] [--twilio-url http://...]
+
+const http = require('http');
+const crypto = require('crypto');
+const querystring = require('querystring');
+const Histogram = require('./histogram');
+
+const config = {
+    port: 8080,
+    event: 'SendSmsEvent',
+    from: '+15005550006',
+    to: '{{{t}}}',
+    body: '{{{b}}}',
+    accountSid: 'ACmock',
+    authToken: 'mocktoken',
+    twilioRate: 1,        // Messages per second sent from the queue (long code numbers are 1 per second)
+    twilioConcurrency: 100, // Simultaneous API requests before returning 20429 Too Many Requests
+    twilioQueueSec: 14400,  // Queue holds this many seconds of messages at twilioRate; more fail with 30001 Queue overflow
+    publishRate: 1,       // Per-device publish rate limit is 1 per second, with bursts of up to 4
+    publishBurst: 4,
+    errorRate: 0,         // Fraction of Twilio requests that fail with a 500 error
+    latencyMs: 0,         // Added delay before the Twilio API responds
+    twilioUrl: '',        // Default is the emulated API on this server
+    keepMessages: 100,
+};
+
+for (let ii = 2; ii < process.argv.length; ii++) {
+    const arg = process.argv[ii];
+    if (!arg.startsWith('--') || ii + 1 >= process.argv.length) {
+        console.log('unknown argument ' + arg);
+        process.exit(1);
+    }
+    const key = arg.substring(2).replace(/-([a-z])/g, (m, c) => c.toUpperCase());
+    if (!(key in config)) {
+        console.log('unknown option ' + arg);
+        process.exit(1);
+    }
+    const value = process.argv[++ii];
+    config[key] = (typeof config[key] === 'number') ? parseFloat(value) : value;
+}
+
+if (!config.twilioUrl) {
+    config.twilioUrl = 'http://localhost:' + config.port + '/2010-04-01/Accounts/' + config.accountSid + '/Messages.json';
+}
+
+const stats = {
+    startTime: Date.now(),
+    publish: { received: 0, rateLimited: 0, matched: 0 },
+    webhook: { sent: 0, success: 0, error: 0, statusCodes: {}, latencyMs: new Histogram() },
+    twilio: { received: 0, accepted: 0, tooManyRequests: 0, invalid: 0, authFailed: 0, injectedErrors: 0, sent: 0, queueOverflow: 0, queueDelayMs: new Histogram() },
+};
+const messages = [];
+
+class TokenBucket {
+    constructor(rate, burst) {
+        this.rate = rate;
+        this.burst = burst;
+        this.tokens = burst;
+        this.lastTime = Date.now();
+    }
+    take() {
+        const now = Date.now();
+        this.tokens = Math.min(this.burst, this.tokens + (now - this.lastTime) * this.rate / 1000);
+        this.lastTime = now;
+        if (this.tokens < 1) {
+            return false;
+        }
+        this.tokens--;
+        return true;
+    }
+}
+
+// The publish rate limit is per device
+const publishBuckets = {};
+
+// Fixed-capacity FIFO, so memory use stays constant and removing from the front is O(1)
+class RingQueue {
+    constructor(capacity) {
+        this.items = new Array(capacity);
+        this.head = 0;
+        this.length = 0;
+    }
+    isFull() {
+        return this.length >= this.items.length;
+    }
+    push(item) {
+        this.items[(this.head + this.length) % this.items.length] = item;
+        this.length++;
+    }
+    shift() {
+        if (this.length == 0) {
+            return undefined;
+        }
+        const item = this.items[this.head];
+        this.items[this.head] = undefined;
+        this.head = (this.head + 1) % this.items.length;
+        this.length--;
+        return item;
+    }
+}
+
+// Twilio accepts messages over the per-number rate and queues them, sending at twilioRate. The
+// queue holds twilioQueueSec of messages (4 hours by default); messages beyond that are rejected.
+const twilioQueue = new RingQueue(Math.max(1, Math.ceil(config.twilioRate * config.twilioQueueSec)));
+let twilioInFlight = 0;
+
+setInterval(() => {
+    const entry = twilioQueue.shift();
+    if (!entry) {
+        return;
+    }
+    const message = entry.message;
+    stats.twilio.queueDelayMs.add(Date.now() - entry.queuedAt);
+    stats.twilio.sent++;
+    message.status = 'sent';
+    message.date_updated = new Date().toUTCString();
+    console.log('SMS to ' + message.to + ': ' + message.body);
+}, 1000 / config.twilioRate);
+
+// Minimal mustache: {{{key}}} is replaced unescaped, {{key}} is HTML-escaped
+function renderTemplate(template, vars) {
+    return template
+        .replace(/\{\{\{\s*([A-Za-z0-9_]+)\s*\}\}\}/g, (m, key) => (key in vars) ? String(vars[key]) : '')
+        .replace(/\{\{\s*([A-Za-z0-9_]+)\s*\}\}/g, (m, key) => (key in vars) ? String(vars[key])
+            .replace(/&/g, '&amp;').replace(/</g, '&lt;').replace(/>/g, '&gt;').replace(/"/g, '&quot;') : '');
+}
+
+function readBody(req) {
+    return new Promise((resolve) => {
+        let body = '';
+        req.on('data', (chunk) => body += chunk);
+        req.on('end', () => resolve(body));
+    });
+}
+
+function parseBody(req, body) {
+    if ((req.headers['content-type'] || '').startsWith('application/json')) {
+        try {
+            return JSON.parse(body);
+        }
+        catch (e) {
+            return {};
+        }
+    }
+    return querystring.parse(body);
+}
+
+function sendJson(res, statusCode, obj) {
+    res.writeHead(statusCode, { 'Content-Type': 'application/json' });
+    res.end(JSON.stringify(obj));
+}
+
+function twilioError(res, status, code, message) {
+    sendJson(res, status, { code, message, more_info: 'https://www.twilio.com/docs/errors/' + code, status });
+}
+
+function runWebhook(eventName, eventData) {
+    const vars = {
+        PARTICLE_EVENT_NAME: eventName,
+        PARTICLE_EVENT_VALUE: eventData,
+        PARTICLE_DEVICE_ID: 'mockdevice',
+        PARTICLE_PUBLISHED_AT: new Date().toISOString(),
+    };
+    try {
+        Object.assign(vars, JSON.parse(eventData));
+    }
+    catch (e) {
+        // Not JSON, only the PARTICLE_ variables are available, same as the real webhook
+    }
+
+    const form = querystring.stringify({
+        From: renderTemplate(config.from, vars),
+        To: renderTemplate(config.to, vars),
+        Body: renderTemplate(config.body, vars),
+    });
+
+    const url = new URL(config.twilioUrl);
+    const startTime = Date.now();
+    stats.webhook.sent++;
+
+    const req = http.request({
+        hostname: url.hostname,
+        port: url.port,
+        path: url.pathname,
+        method: 'POST',
+        auth: config.accountSid + ':' + config.authToken,
+        headers: {
+            'Content-Type': 'application/x-www-form-urlencoded',
+            'Content-Length': Buffer.byteLength(form),
+        },
+    }, async (res) => {
+        const body = await readBody(res);
+        const latency = Date.now() - startTime;
+        stats.webhook.latencyMs.add(latency);
+        stats.webhook.statusCodes[res.statusCode] = (stats.webhook.statusCodes[res.statusCode] || 0) + 1;
+        if (res.statusCode >= 200 && res.statusCode < 300) {
+            stats.webhook.success++;
+        }
+        else {
+            // Like the integration log in the console
+            stats.webhook.error++;
+            console.log('webhook error ' + res.statusCode + ' ' + body);
+        }
+    });
+    req.on('error', (err) => {
+        stats.webhook.error++;
+        console.log('webhook request failed ' + err.message);
+    });
+    req.end(form);
+}
+
+function handlePublish(req, res, params) {
+    stats.publish.received++;
+
+    // deviceId is not part of the Particle API; the load test sends it so each simulated device
+    // gets its own rate limit, the same as real devices
+    const deviceId = params.deviceId || 'default';
+    if (!publishBuckets[deviceId]) {
+        publishBuckets[deviceId] = new TokenBucket(config.publishRate, config.publishBurst);
+    }
+    if (!publishBuckets[deviceId].take()) {
+        // The device would get a failed publish (Future not succeeded)
+        stats.publish.rateLimited++;
+        sendJson(res, 429, { ok: false, error: 'publish rate limit exceeded' });
+        return;
+    }
+
+    const name = params.name || '';
+    const data = params.data || '';
+    if (!name || name.length > 64 || data.length > 1024) {
+        sendJson(res, 400, { ok: false, error: 'invalid event' });
+        return;
+    }
+
+    // This is the ACK the device waits for with WITH_ACK; the webhook runs asynchronously
+    sendJson(res, 200, { ok: true });
+
+    // Event name is a prefix match, same as the real webhook
+    if (name.startsWith(config.event)) {
+        stats.publish.matched++;
+        runWebhook(name, data);
+    }
+}
+
+function handleTwilio(req, res, params, accountSid) {
+    stats.twilio.received++;
+
+    const expectedAuth = 'Basic ' + Buffer.from(config.accountSid + ':' + config.authToken).toString('base64');
+    if (req.headers['authorization'] !== expectedAuth) {
+        stats.twilio.authFailed++;
+        return twilioError(res, 401, 20003, 'Authentication Error - invalid username');
+    }
+    if (accountSid !== config.accountSid) {
+        stats.twilio.authFailed++;
+        return twilioError(res, 404, 20404, 'The requested resource was not found');
+    }
+    if (config.errorRate > 0 && Math.random() < config.errorRate) {
+        stats.twilio.injectedErrors++;
+        return twilioError(res, 500, 20500, 'Internal Server Error');
+    }
+    if (twilioInFlight >= config.twilioConcurrency) {
+        // Concurrency overload. Exceeding the per-number rate does not cause this; those messages are queued.
+        stats.twilio.tooManyRequests++;
+        return twilioError(res, 429, 20429, 'Too Many Requests');
+    }
+
+    const to = params.To || '';
+    const from = params.From || '';
+    const body = params.Body || '';
+    if (!to) {
+        stats.twilio.invalid++;
+        return twilioError(res, 400, 21604, "A 'To' phone number is required.");
+    }
+    if (!/^\+[1-9][0-9]{1,14}$/.test(to)) {
+        stats.twilio.invalid++;
+        return twilioError(res, 400, 21211, "The 'To' number " + to + ' is not a valid phone number.');
+    }
+    if (from !== config.from) {
+        stats.twilio.invalid++;
+        return twilioError(res, 400, 21606, "The From phone number " + from + ' is not a valid, SMS-capable inbound phone number or short code for your account.');
+    }
+    if (!body) {
+        stats.twilio.invalid++;
+        return twilioError(res, 400, 21602, 'Message body is required.');
+    }
+    if (body.length > 1600) {
+        stats.twilio.invalid++;
+        return twilioError(res, 400, 21617, 'The concatenated message body exceeds the 1600 character limit.');
+    }
+
+    if (twilioQueue.isFull()) {
+        stats.twilio.queueOverflow++;
+        return twilioError(res, 400, 30001, 'Queue overflow');
+    }
+
+    stats.twilio.accepted++;
+    const now = new Date().toUTCString();
+    const message = {
+        sid: 'SM' + crypto.randomBytes(16).toString('hex'),
+        account_sid: accountSid,
+        from,
+        to,
+        body,
+        status: 'queued',
+        num_segments: String(Math.ceil(body.length / 160)),
+        direction: 'outbound-api',
+        date_created: now,
+        date_updated: now,
+        api_version: '2010-04-01',
+    };
+    messages.push(message);
+    if (messages.length > config.keepMessages) {
+        messages.shift();
+    }
+    twilioQueue.push({ message, queuedAt: Date.now() });
+
+    twilioInFlight++;
+    setTimeout(() => {
+        twilioInFlight--;
+        sendJson(res, 201, message);
+    }, config.latencyMs);
+}
+
+function getStats() {
+    const result = JSON.parse(JSON.stringify(stats));
+    result.uptimeSec = Math.round((Date.now() - stats.startTime) / 1000);
+    result.webhook.latencyMs = stats.webhook.latencyMs.summary();
+    result.twilio.queueDelayMs = stats.twilio.queueDelayMs.summary();
+    result.twilio.queueLength = twilioQueue.length;
+    return result;
+}
+
+const server = http.createServer(async (req, res) => {
+    const url = new URL(req.url, 'http://localhost');
+    const body = await readBody(req);
+
+    if (req.method == 'POST' && url.pathname == '/v1/devices/events') {
+        return handlePublish(req, res, parseBody(req, body));
+    }
+
+    const twilioMatch = url.pathname.match(/^\/2010-04-01\/Accounts\/([^/]+)\/Messages\.json$/);
+    if (req.method == 'POST' && twilioMatch) {
+        return handleTwilio(req, res, parseBody(req, body), twilioMatch[1]);
+    }
+
+    if (req.method == 'GET' && url.pathname == '/stats') {
+        return sendJson(res, 200, getStats());
+    }
+    if (req.method == 'GET' && url.pathname == '/messages') {
+        return sendJson(res, 200, messages);
+    }
+
+    sendJson(res, 404, { ok: false, error: 'not found' });
+});
+
+server.listen(config.port, () => {
+    console.log('mock cloud listening on port ' + config.port + ', event ' + config.event + ', Twilio API ' + config.twilioUrl);
+});
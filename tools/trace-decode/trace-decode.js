@@ -0,0 +1,174 @@
+#!/usr/bin/env node
+// Decoder for the output of SmsTrace::dump()
+//
+// Github: https://github.com/rickkas7/SmsWebhookRK
+// License: MIT
+//
+// Usage: node trace-decode.js [serial-log.txt]
+//
+// Reads a serial log (or stdin) containing SMSTRACE lines, and prints the events with timestamps
+// relative to the first event and since boot, the loop time histogram, and per-message latency:
+// the time from when a message was queued until the publish of it succeeded.
+
+const fs = require('fs');
+
+const EVENTS = {
+    1: 'STATE',
+    2: 'QUEUE_PUSH',
+    3: 'QUEUE_POP',
+    4: 'RECIPIENT',
+    5: 'PUBLISH_START',
+    6: 'PUBLISH_RESULT',
+    7: 'LOOP',
+    8: 'DELAYED_QUEUE',
+};
+
+const STATES = {
+    1: 'stateWaitForMessage',
+    2: 'stateWaitPublish',
+    3: 'stateWaitRetry',
+};
+
+function describe(entry) {
+    switch (EVENTS[entry.event]) {
+        case 'STATE':
+            return '-> ' + (STATES[entry.arg8] || ('state ' + entry.arg8));
+        case 'QUEUE_PUSH':
+            return 'queue size ' + entry.arg16 + ', message length ' + entry.arg32;
+        case 'QUEUE_POP':
+            return 'queue size ' + entry.arg16;
+        case 'RECIPIENT':
+            return (entry.arg8 ? 'known' : 'not known') + ', callback ' + entry.arg32 + ' us';
+        case 'PUBLISH_START':
+            return 'data length ' + entry.arg16;
+        case 'PUBLISH_RESULT':
+            return (entry.arg8 ? 'succeeded' : 'failed') + ' after ' + entry.arg32 + ' ms';
+        case 'LOOP':
+            return entry.arg32 + ' us';
+        case 'DELAYED_QUEUE':
+            return 'persist ID ' + entry.arg16;
+        default:
+            return 'arg8=' + entry.arg8 + ' arg16=' + entry.arg16 + ' arg32=' + entry.arg32;
+    }
+}
+
+function formatMs(us) {
+    return (us / 1000).toFixed(3) + ' ms';
+}
+
+function formatUptime(us) {
+    const sec = us / 1000000;
+    const hours = Math.floor(sec / 3600);
+    const minutes = Math.floor((sec % 3600) / 60);
+    return hours + ':' + String(minutes).padStart(2, '0') + ':' + (sec % 60).toFixed(3).padStart(6, '0');
+}
+
+function decodeTrace(lines) {
+    const entries = [];
+    let header;
+    let histogram;
+    let dropped = 0;
+
+    for (const line of lines) {
+        const parts = line.substring(line.indexOf('SMSTRACE') + 8).trim().split(/\s+/);
+        if (parts[0] == 'begin') {
+            header = { count: parseInt(parts[1]), loopCount: parseInt(parts[2]), loopAvgUs: parseInt(parts[3]), loopMaxUs: parseInt(parts[4]) };
+        }
+        else if (parts[0] == 'hist') {
+            histogram = parts.slice(1).map((n) => parseInt(n));
+        }
+        else if (parts[0] == 'end') {
+            dropped = parseInt(parts[1]) || 0;
+        }
+        else if (parts.length == 5) {
+            // 64-bit microseconds since boot; exact as a Number for 285 years of uptime
+            entries.push({
+                micros: parseInt(parts[0], 16),
+                event: parseInt(parts[1], 16),
+                arg8: parseInt(parts[2], 16),
+                arg16: parseInt(parts[3], 16),
+                arg32: parseInt(parts[4], 16),
+            });
+        }
+    }
+
+    if (header) {
+        console.log('loop calls ' + header.loopCount + ', average ' + header.loopAvgUs + ' us, max ' + header.loopMaxUs + ' us');
+    }
+    if (histogram) {
+        histogram.forEach((count, ii) => {
+            if (count) {
+                const label = (ii == histogram.length - 1) ? '>= ' + Math.pow(2, ii - 1) + ' us' : '< ' + Math.pow(2, ii) + ' us';
+                console.log('  ' + label.padStart(14) + ' ' + count);
+            }
+        });
+    }
+    if (entries.length == 0) {
+        console.log('no events');
+        return;
+    }
+
+    const pushTimes = [];
+    const messageLatency = [];
+    let lastPublishStart;
+
+    console.log('');
+    console.log('time from first'.padStart(16) + '  ' + 'since boot'.padStart(14));
+    for (const entry of entries) {
+        // Timestamps are 64-bit so they don't wrap, even with hours between events
+        entry.time = entry.micros - entries[0].micros;
+
+        const name = EVENTS[entry.event] || ('EVENT ' + entry.event);
+        console.log(formatMs(entry.time).padStart(16) + '  ' + formatUptime(entry.micros).padStart(14) + '  ' + name.padEnd(15) + describe(entry));
+
+        // The queue is FIFO, so pushes and pops match in order. Pops for messages queued
+        // before the trace started don't have a matching push and are skipped.
+        if (name == 'QUEUE_PUSH') {
+            pushTimes.push(entry.time);
+        }
+        else if (name == 'PUBLISH_START') {
+            lastPublishStart = entry.time;
+        }
+        else if (name == 'QUEUE_POP') {
+            if (pushTimes.length > 0 && entry.arg16 < pushTimes.length) {
+                const pushTime = pushTimes.shift();
+                messageLatency.push({ queued: pushTime, total: entry.time - pushTime, publish: entry.time - lastPublishStart });
+            }
+        }
+    }
+
+    if (dropped) {
+        console.log(dropped + ' events were discarded while the dump was running');
+    }
+
+    if (messageLatency.length) {
+        console.log('');
+        console.log('message latency (queued until publish succeeded):');
+        for (const latency of messageLatency) {
+            console.log('  queued at ' + formatMs(latency.queued) + ': ' + formatMs(latency.total) + ' total, ' + formatMs(latency.publish) + ' in final publish');
+        }
+    }
+}
+
+const input = fs.readFileSync(process.argv.length > 2 ? process.argv[2] : 0, 'utf8');
+
+// A log may contain several dumps; decode each one separately
+let lines = [];
+for (const line of input.split(/\r?\n/)) {
+    if (!line.includes('SMSTRACE')) {
+        continue;
+    }
+    if (line.includes('SMSTRACE begin')) {
+        lines = [];
+    }
+    lines.push(line);
+    if (line.includes('SMSTRACE end')) {
+        decodeTrace(lines);
+        console.log('');
+        lines = [];
+    }
+}
+if (lines.length) {
+    // Dump was cut off
+    decodeTrace(lines);
+}